@@ -0,0 +1,357 @@
+/*
+  ==============================================================================
+
+    Headless soak test for FODEQAudioProcessor.
+
+    Drives the processor from a simulated audio thread the way a busy host would:
+    random block sizes (some larger than maximumBlockSize), automation bursts on every
+    parameter, stretches of dual-mono input, state restores from another thread, the
+    editor being opened and closed on the message thread, and prepareToPlay sample rate
+    changes. At the end it reports processBlock latency percentiles and any device periods
+    (--block-size samples' worth of processBlock calls) that missed their deadline.
+
+    Usage: FODEQSoakTest [--seconds N] [--deadline-ms N] [--block-size N] [--seed N] [--unpaced]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+	struct SoakOptions
+	{
+		double DurationSeconds = 120.0;
+		double DeadlineMilliseconds = 0.0; // Per device period. 0 means the period's duration at the current sample rate.
+		int MaximumBlockSize = 512;
+		juce::int64 Seed = 0;
+		bool Paced = true; // Wait out each block's duration like a real audio device would
+	};
+
+	// Processing times bucketed per microsecond, so recording them never allocates on the audio thread
+	class LatencyHistogram
+	{
+	public:
+		static constexpr int NumBuckets = 100000; // Up to 100 ms
+
+		LatencyHistogram() : Counts(NumBuckets, 0) {}
+
+		void Add(double Seconds)
+		{
+			const auto Bucket = juce::jlimit(0, NumBuckets - 1, static_cast<int>(Seconds * 1.0e6));
+			++Counts[static_cast<size_t>(Bucket)];
+			++Total;
+			Max = juce::jmax(Max, Seconds);
+		}
+
+		// Returns the percentile in microseconds
+		double GetPercentile(double Percentile) const
+		{
+			const auto Target = static_cast<juce::int64>(std::ceil(Percentile / 100.0 * static_cast<double>(Total)));
+			juce::int64 Cumulative = 0;
+			for (int Bucket = 0; Bucket < NumBuckets; ++Bucket)
+			{
+				Cumulative += Counts[static_cast<size_t>(Bucket)];
+				if (Cumulative >= Target)
+					return Bucket + 1.0;
+			}
+			return NumBuckets;
+		}
+
+		juce::int64 GetTotal() const { return Total; }
+		double GetMaxMicroseconds() const { return Max * 1.0e6; }
+
+	private:
+		std::vector<juce::int64> Counts;
+		juce::int64 Total = 0;
+		double Max = 0.0;
+	};
+
+	class SimulatedAudioThread : public juce::Thread
+	{
+	public:
+		SimulatedAudioThread(FODEQAudioProcessor& p, const SoakOptions& o) :
+			juce::Thread("Simulated audio thread"), Processor(p), Options(o)
+		{
+		}
+
+		void run() override
+		{
+			juce::Random Random(Options.Seed);
+
+			// Allocate enough up front for the oversized blocks so the loop never reallocates
+			const int LargestBlockSize = Options.MaximumBlockSize * 4;
+			juce::AudioBuffer<float> Buffer(Processor.getTotalNumInputChannels(), LargestBlockSize);
+			juce::MidiBuffer MidiBuffer;
+
+			auto SampleRate = PickSampleRate(Random);
+			Prepare(SampleRate);
+
+			const auto StartTime = Clock::now();
+			const auto EndTime = StartTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Options.DurationSeconds));
+			auto NextBlockTime = StartTime;
+			int BurstBlocksRemaining = 0;
+			int DualMonoBlocksRemaining = 0;
+
+			// Hosts split a device period into sub-blocks of any size, and it's the period as a whole that
+			// has to be done in time, so processing time is added up over at least MaximumBlockSize samples
+			int PeriodSamples = 0;
+			double PeriodProcessSeconds = 0.0;
+
+			while (!threadShouldExit() && Clock::now() < EndTime)
+			{
+				// 1. Hosts change the sample rate between blocks, never during one
+				if (Random.nextInt(5000) == 0)
+				{
+					SampleRate = PickSampleRate(Random);
+					Prepare(SampleRate);
+					PeriodSamples = 0;
+					PeriodProcessSeconds = 0.0;
+				}
+
+				// 2. Mostly the usual power-of-two sizes, sometimes odd ones, occasionally more than we were promised
+				int NumSamples = Options.MaximumBlockSize >> Random.nextInt(4);
+				const auto BlockSizeRoll = Random.nextInt(100);
+				if (BlockSizeRoll < 20)
+					NumSamples = 1 + Random.nextInt(Options.MaximumBlockSize);
+				else if (BlockSizeRoll < 22)
+					NumSamples = Options.MaximumBlockSize + 1 + Random.nextInt(LargestBlockSize - Options.MaximumBlockSize);
+
+				// 3. Automation bursts move every parameter on every block for a while
+				if (BurstBlocksRemaining == 0 && Random.nextInt(200) == 0)
+					BurstBlocksRemaining = 50 + Random.nextInt(200);
+
+				if (BurstBlocksRemaining > 0)
+				{
+					--BurstBlocksRemaining;
+					for (auto* Parameter : Processor.getParameters())
+					{
+						// Hosts don't automate options like the parallel engine, which gets its own toggle below
+						if (!Parameter->isAutomatable())
+							continue;
+
+						const auto Value = Random.nextFloat();
+						Parameter->setValue(Value);
+						Parameter->sendValueChangedMessageToListeners(Value);
+					}
+				}
+
+				// Flip between the serial and parallel engines now and then
+				if (Random.nextInt(2000) == 0)
+					Processor.SetParallelEngineEnabled(Random.nextBool());
+
+				// 4. Noise at about -12 dBFS, with stretches of dual-mono material so the channels link and unlink
+				if (DualMonoBlocksRemaining == 0 && Random.nextInt(100) == 0)
+					DualMonoBlocksRemaining = 100 + Random.nextInt(1000);
+
+				Buffer.setSize(Buffer.getNumChannels(), NumSamples, false, false, true);
+				for (int Channel = 0; Channel < Buffer.getNumChannels(); ++Channel)
+				{
+					auto* Samples = Buffer.getWritePointer(Channel);
+					for (int Sample = 0; Sample < NumSamples; ++Sample)
+						Samples[Sample] = (Random.nextFloat() * 2.f - 1.f) * 0.25f;
+				}
+
+				if (DualMonoBlocksRemaining > 0)
+				{
+					--DualMonoBlocksRemaining;
+					for (int Channel = 1; Channel < Buffer.getNumChannels(); ++Channel)
+						Buffer.copyFrom(Channel, 0, Buffer, 0, 0, NumSamples);
+				}
+
+				const auto ProcessStart = juce::Time::getHighResolutionTicks();
+				Processor.processBlock(Buffer, MidiBuffer);
+				const auto ProcessSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - ProcessStart);
+
+				Latencies.Add(ProcessSeconds);
+
+				PeriodSamples += NumSamples;
+				PeriodProcessSeconds += ProcessSeconds;
+				if (PeriodSamples >= Options.MaximumBlockSize)
+				{
+					// An oversized block counts as however many periods it covers
+					const auto PeriodMilliseconds = 1000.0 * PeriodSamples / SampleRate;
+					const auto DeadlineMilliseconds = Options.DeadlineMilliseconds > 0.0
+						? Options.DeadlineMilliseconds * PeriodSamples / Options.MaximumBlockSize
+						: PeriodMilliseconds;
+					if (PeriodProcessSeconds * 1000.0 > DeadlineMilliseconds)
+						++NumDeadlineMisses;
+
+					++NumPeriods;
+					PeriodSamples = 0;
+					PeriodProcessSeconds = 0.0;
+				}
+
+				// 5. Wait for the device to ask for the next block
+				if (Options.Paced)
+				{
+					NextBlockTime += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(NumSamples / SampleRate));
+					const auto Now = Clock::now();
+					if (NextBlockTime > Now)
+						std::this_thread::sleep_until(NextBlockTime);
+					else
+						NextBlockTime = Now;
+				}
+			}
+
+			Processor.releaseResources();
+		}
+
+		LatencyHistogram Latencies;
+		juce::int64 NumDeadlineMisses = 0;
+		juce::int64 NumPeriods = 0;
+		int NumPrepares = 0;
+		double MaxPrepareMilliseconds = 0.0;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		FODEQAudioProcessor& Processor;
+		const SoakOptions Options;
+
+		double PickSampleRate(juce::Random& Random) const
+		{
+			const double SampleRates[] = { 44100.0, 48000.0, 88200.0, 96000.0, 192000.0 };
+			return SampleRates[Random.nextInt(juce::numElementsInArray(SampleRates))];
+		}
+
+		void Prepare(double SampleRate)
+		{
+			const auto PrepareStart = juce::Time::getHighResolutionTicks();
+			Processor.releaseResources();
+			Processor.setRateAndBufferSizeDetails(SampleRate, Options.MaximumBlockSize);
+			Processor.prepareToPlay(SampleRate, Options.MaximumBlockSize);
+			const auto PrepareSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - PrepareStart);
+
+			++NumPrepares;
+			MaxPrepareMilliseconds = juce::jmax(MaxPrepareMilliseconds, PrepareSeconds * 1000.0);
+		}
+	};
+
+	// Saves and restores the plugin state from a thread that isn't the audio thread, as hosts do on preset changes
+	class StateChurnThread : public juce::Thread
+	{
+	public:
+		StateChurnThread(FODEQAudioProcessor& p, juce::int64 Seed) :
+			juce::Thread("State churn thread"), Processor(p), Random(Seed)
+		{
+		}
+
+		void run() override
+		{
+			std::vector<juce::MemoryBlock> Snapshots;
+
+			while (!threadShouldExit())
+			{
+				wait(20 + Random.nextInt(400));
+
+				juce::MemoryBlock State;
+				Processor.getStateInformation(State);
+				Snapshots.push_back(std::move(State));
+				if (Snapshots.size() > 16)
+					Snapshots.erase(Snapshots.begin());
+
+				// Restore an older state so the restore actually moves the parameters
+				const auto& Snapshot = Snapshots[static_cast<size_t>(Random.nextInt(static_cast<int>(Snapshots.size())))];
+				Processor.setStateInformation(Snapshot.getData(), static_cast<int>(Snapshot.getSize()));
+				++NumRestores;
+			}
+		}
+
+		std::atomic<int> NumRestores { 0 };
+
+	private:
+		FODEQAudioProcessor& Processor;
+		juce::Random Random;
+	};
+
+	SoakOptions ParseOptions(const juce::ArgumentList& Arguments)
+	{
+		SoakOptions Options;
+
+		if (Arguments.containsOption("--seconds"))
+			Options.DurationSeconds = Arguments.getValueForOption("--seconds").getDoubleValue();
+		if (Arguments.containsOption("--deadline-ms"))
+			Options.DeadlineMilliseconds = Arguments.getValueForOption("--deadline-ms").getDoubleValue();
+		if (Arguments.containsOption("--block-size"))
+			Options.MaximumBlockSize = juce::jmax(16, Arguments.getValueForOption("--block-size").getIntValue());
+		Options.Seed = Arguments.containsOption("--seed") ? Arguments.getValueForOption("--seed").getLargeIntValue()
+														  : juce::Time::currentTimeMillis();
+		Options.Paced = !Arguments.containsOption("--unpaced");
+
+		return Options;
+	}
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+	// The editor and its timers need a message thread, which is this one
+	juce::ScopedJuceInitialiser_GUI JuceInitialiser;
+
+	const auto Options = ParseOptions(juce::ArgumentList(argc, argv));
+	std::cout << "FODEQ soak test: " << Options.DurationSeconds << " s, maximum block size " << Options.MaximumBlockSize
+			  << ", seed " << Options.Seed << std::endl;
+
+	FODEQAudioProcessor Processor;
+	SimulatedAudioThread AudioThread(Processor, Options);
+	StateChurnThread StateThread(Processor, Options.Seed + 1);
+
+	AudioThread.startThread(juce::Thread::Priority::highest);
+	StateThread.startThread();
+
+	// Open and close the editor (and with it the ResponseCurveComponent's parameter listeners) while the audio runs
+	juce::Random Random(Options.Seed + 2);
+	std::unique_ptr<juce::AudioProcessorEditor> Editor;
+	int NumEditorOpens = 0;
+
+	while (AudioThread.isThreadRunning())
+	{
+		if (Editor == nullptr)
+		{
+			Editor.reset(Processor.createEditorAndMakeActive());
+			++NumEditorOpens;
+		}
+		else
+		{
+			Editor.reset();
+		}
+
+		juce::MessageManager::getInstance()->runDispatchLoopUntil(100 + Random.nextInt(2000));
+	}
+
+	Editor.reset();
+	StateThread.stopThread(1000);
+
+	const auto& Latencies = AudioThread.Latencies;
+	const auto NumBlocks = Latencies.GetTotal();
+
+	std::cout << NumBlocks << " blocks, " << AudioThread.NumPrepares << " prepareToPlay calls (slowest "
+			  << AudioThread.MaxPrepareMilliseconds << " ms), " << StateThread.NumRestores.load() << " state restores, "
+			  << NumEditorOpens << " editor opens" << std::endl;
+
+	std::cout << "processBlock latency (us):"
+			  << " p50 " << Latencies.GetPercentile(50.0)
+			  << " p90 " << Latencies.GetPercentile(90.0)
+			  << " p99 " << Latencies.GetPercentile(99.0)
+			  << " p99.9 " << Latencies.GetPercentile(99.9)
+			  << " p99.99 " << Latencies.GetPercentile(99.99)
+			  << " max " << Latencies.GetMaxMicroseconds() << std::endl;
+
+	const auto NumPeriods = AudioThread.NumPeriods;
+	const auto MissPercentage = NumPeriods > 0 ? 100.0 * static_cast<double>(AudioThread.NumDeadlineMisses) / static_cast<double>(NumPeriods) : 0.0;
+	std::cout << "Deadline misses: " << AudioThread.NumDeadlineMisses << " of " << NumPeriods << " device periods ("
+			  << MissPercentage << "%)" << std::endl;
+
+	const auto CacheStatistics = FilterDesignCache::GetInstance().GetStatistics();
+	std::cout << "Filter design cache: " << 100.0 * CacheStatistics.GetHitRate() << "% hit rate, "
+			  << CacheStatistics.NumEntries << " entries, " << CacheStatistics.Evictions << " evictions, "
+			  << CacheStatistics.NumRetired << " awaiting release" << std::endl;
+
+	return AudioThread.NumDeadlineMisses > 0 ? 1 : 0;
+}
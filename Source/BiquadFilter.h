@@ -0,0 +1,116 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Drop-in replacement for juce::dsp::IIR::Filter<float> covering first and second order filters (all the EQ
+// uses), with the same transposed direct form II processing. Unlike the JUCE filter it lets one filter's state
+// be compared with and copied into another's, which is what lets identical channels share a single chain.
+class BiquadFilter
+{
+public:
+	using CoefficientsPtr = juce::dsp::IIR::Coefficients<float>::Ptr;
+
+	BiquadFilter() : coefficients(new juce::dsp::IIR::Coefficients<float>(1.f, 0.f, 1.f, 0.f))
+	{
+	}
+
+	void prepare(const juce::dsp::ProcessSpec&) noexcept
+	{
+		reset();
+	}
+
+	void reset() noexcept
+	{
+		State = {};
+	}
+
+	void CopyStateFrom(const BiquadFilter& Other) noexcept
+	{
+		State = Other.State;
+	}
+
+	bool StateMatches(const BiquadFilter& Other, float Tolerance) const noexcept
+	{
+		return std::abs(State[0] - Other.State[0]) <= Tolerance && std::abs(State[1] - Other.State[1]) <= Tolerance;
+	}
+
+	float processSample(float Sample) noexcept
+	{
+		const auto* c = coefficients->getRawCoefficients();
+		const auto Order = coefficients->getFilterOrder();
+		jassert(Order == 1 || Order == 2);
+
+		const auto Output = c[0] * Sample + State[0];
+		if (Order == 2)
+		{
+			State[0] = c[1] * Sample - c[3] * Output + State[1];
+			State[1] = c[2] * Sample - c[4] * Output;
+		}
+		else
+		{
+			State[0] = c[1] * Sample - c[2] * Output;
+		}
+
+		return Output;
+	}
+
+	template<typename ProcessContext>
+	void process(const ProcessContext& Context) noexcept
+	{
+		auto&& InputBlock = Context.getInputBlock();
+		auto&& OutputBlock = Context.getOutputBlock();
+		jassert(InputBlock.getNumChannels() == 1 && OutputBlock.getNumChannels() == 1);
+
+		const auto NumSamples = InputBlock.getNumSamples();
+		const auto* Input = InputBlock.getChannelPointer(0);
+		auto* Output = OutputBlock.getChannelPointer(0);
+
+		// Like the JUCE filter, a bypassed filter still runs to keep its state warm but passes its input through
+		const auto IsBypassed = Context.isBypassed;
+		const auto* c = coefficients->getRawCoefficients();
+		auto S0 = State[0];
+		auto S1 = State[1];
+
+		if (coefficients->getFilterOrder() == 2)
+		{
+			const auto B0 = c[0], B1 = c[1], B2 = c[2], A1 = c[3], A2 = c[4];
+			for (size_t Sample = 0; Sample < NumSamples; ++Sample)
+			{
+				const auto In = Input[Sample];
+				const auto Out = B0 * In + S0;
+				S0 = B1 * In - A1 * Out + S1;
+				S1 = B2 * In - A2 * Out;
+				Output[Sample] = IsBypassed ? In : Out;
+			}
+		}
+		else
+		{
+			jassert(coefficients->getFilterOrder() == 1);
+			const auto B0 = c[0], B1 = c[1], A1 = c[2];
+			for (size_t Sample = 0; Sample < NumSamples; ++Sample)
+			{
+				const auto In = Input[Sample];
+				const auto Out = B0 * In + S0;
+				S0 = B1 * In - A1 * Out;
+				Output[Sample] = IsBypassed ? In : Out;
+			}
+		}
+
+		State[0] = S0;
+		State[1] = S1;
+
+		SnapToZero(State[0]);
+		SnapToZero(State[1]);
+	}
+
+	CoefficientsPtr coefficients;
+
+private:
+	static void SnapToZero(float& Value) noexcept
+	{
+		if (!(Value < -1.0e-8f || Value > 1.0e-8f))
+			Value = 0.f;
+	}
+
+	std::array<float, 2> State {};
+};
@@ -0,0 +1,150 @@
+#include "FilterDesignCache.h"
+
+juce::uint64 FilterDesignKey::GetHash() const
+{
+	// FNV-1a over the key's fields
+	juce::uint64 Hash = 14695981039346656037ull;
+	for (auto Field : { static_cast<juce::int32>(Band), SampleRate, Frequency, Gain, Quality, Slope })
+	{
+		Hash ^= static_cast<juce::uint32>(Field);
+		Hash *= 1099511628211ull;
+	}
+	return Hash;
+}
+
+FilterDesignCache& FilterDesignCache::GetInstance()
+{
+	static FilterDesignCache Instance;
+	return Instance;
+}
+
+FilterDesignCache::~FilterDesignCache()
+{
+	for (auto& CacheSlot : Slots)
+	{
+		if (auto* Design = CacheSlot.Design.exchange(nullptr))
+			Design->decReferenceCount();
+	}
+
+	for (int i = 0; i < NumRetired; ++i)
+		Retired[static_cast<size_t>(i)].Design->decReferenceCount();
+}
+
+FilterDesign::Ptr FilterDesignCache::Find(const FilterDesignKey& Key)
+{
+	const auto FirstSlot = static_cast<int>(Key.GetHash() % NumSets) * NumWays;
+	for (int Way = 0; Way < NumWays; ++Way)
+	{
+		auto& SetSlot = Slots[static_cast<size_t>(FirstSlot + Way)];
+
+		// While we're registered as a reader the design in this slot can't be released, so it's
+		// safe to take our own reference to it
+		FilterDesign::Ptr Design;
+		SetSlot.NumReaders.fetch_add(1);
+		auto* SlotDesign = SetSlot.Design.load();
+		if (SlotDesign != nullptr && SlotDesign->Key == Key)
+			Design = SlotDesign;
+		SetSlot.NumReaders.fetch_sub(1);
+
+		if (Design != nullptr)
+		{
+			SetSlot.LastUsed.store(++UseCounter, std::memory_order_relaxed);
+			++Hits;
+			return Design;
+		}
+	}
+
+	++Misses;
+	return nullptr;
+}
+
+FilterDesign::Ptr FilterDesignCache::Insert(FilterDesign::Ptr Design)
+{
+	jassert(Design != nullptr);
+
+	// Someone else is already inserting. Hand back the uncached design rather than wait for them.
+	const juce::SpinLock::ScopedTryLockType Lock(WriterLock);
+	if (!Lock.isLocked())
+		return Design;
+
+	ReleaseRetired();
+
+	// Only writers change the slots and we hold the writer lock, so they can be read directly from here on
+	const auto FirstSlot = static_cast<int>(Design->Key.GetHash() % NumSets) * NumWays;
+	Slot* Victim = nullptr;
+	for (int Way = 0; Way < NumWays; ++Way)
+	{
+		auto& SetSlot = Slots[static_cast<size_t>(FirstSlot + Way)];
+		auto* SlotDesign = SetSlot.Design.load();
+
+		if (SlotDesign != nullptr && SlotDesign->Key == Design->Key)
+			return SlotDesign;
+
+		// Prefer an empty slot, otherwise evict the least recently used design
+		const auto IsBetterVictim = Victim == nullptr
+			|| (Victim->Design.load() != nullptr
+				&& (SlotDesign == nullptr || SetSlot.LastUsed.load(std::memory_order_relaxed) < Victim->LastUsed.load(std::memory_order_relaxed)));
+		if (IsBetterVictim)
+			Victim = &SetSlot;
+	}
+
+	// With nowhere to put an evicted design, leave the set alone and hand back the uncached design
+	const auto NeedsEviction = Victim->Design.load() != nullptr;
+	if (NeedsEviction && NumRetired == MaxRetired)
+		return Design;
+
+	Design->incReferenceCount(); // The cache's own reference
+	auto* Evicted = Victim->Design.exchange(Design.get());
+	Victim->LastUsed.store(++UseCounter, std::memory_order_relaxed);
+	++Insertions;
+
+	if (Evicted != nullptr)
+	{
+		// A reader may have loaded the evicted design just before the exchange, so the cache's reference
+		// is kept until a later insert finds it safe to drop
+		Retired[static_cast<size_t>(NumRetired++)] = { Evicted, Victim };
+		NumRetiredDesigns.store(NumRetired);
+		++Evictions;
+	}
+	else
+	{
+		++NumEntries;
+	}
+
+	return Design;
+}
+
+void FilterDesignCache::ReleaseRetired()
+{
+	for (int i = 0; i < NumRetired;)
+	{
+		auto& Entry = Retired[static_cast<size_t>(i)];
+
+		// Readers that come along after the eviction find the new design, so once the slot has no readers
+		// nobody can still be about to take a reference to the old one. Holding on until ours is the only
+		// reference left means the design gets freed here rather than by an instance on the audio thread.
+		if (Entry.EvictedFrom->NumReaders.load() == 0 && Entry.Design->getReferenceCount() == 1)
+		{
+			Entry.Design->decReferenceCount();
+			Entry = Retired[static_cast<size_t>(--NumRetired)];
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	NumRetiredDesigns.store(NumRetired);
+}
+
+FilterDesignCache::Statistics FilterDesignCache::GetStatistics() const
+{
+	Statistics Stats;
+	Stats.Hits = Hits.load();
+	Stats.Misses = Misses.load();
+	Stats.Insertions = Insertions.load();
+	Stats.Evictions = Evictions.load();
+	Stats.NumEntries = NumEntries.load();
+	Stats.NumRetired = NumRetiredDesigns.load();
+	return Stats;
+}
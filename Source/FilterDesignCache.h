@@ -0,0 +1,127 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Quantized description of one band's filter design. Bands with equal keys get identical coefficients.
+struct FilterDesignKey
+{
+	enum class BandType : juce::int32
+	{
+		LowCut,
+		Peak,
+		HighCut
+	};
+
+	BandType Band = BandType::Peak;
+	juce::int32 SampleRate = 0; // In Hz
+	juce::int32 Frequency = 0; // In hundredths of a Hz
+	juce::int32 Gain = 0; // In hundredths of a dB
+	juce::int32 Quality = 0; // In thousandths
+	juce::int32 Slope = 0;
+
+	bool operator==(const FilterDesignKey& Other) const
+	{
+		return Band == Other.Band && SampleRate == Other.SampleRate && Frequency == Other.Frequency
+			&& Gain == Other.Gain && Quality == Other.Quality && Slope == Other.Slope;
+	}
+
+	bool operator!=(const FilterDesignKey& Other) const { return !(*this == Other); }
+
+	juce::uint64 GetHash() const;
+};
+
+// A set of coefficients shared between every plugin instance using the same design. Once it's in the cache
+// nothing may write to it, so anything that needs to modify coefficients in place has to own a copy.
+// Anything holding one of the sections must hold the design as well, since the cache only looks at the
+// design's reference count when deciding it's safe to release.
+struct FilterDesign : juce::ReferenceCountedObject
+{
+	using Ptr = juce::ReferenceCountedObjectPtr<FilterDesign>;
+	using SectionArray = juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>>;
+
+	FilterDesign(const FilterDesignKey& DesignKey, SectionArray DesignSections) :
+		Key(DesignKey), Sections(std::move(DesignSections))
+	{
+	}
+
+	const FilterDesignKey Key;
+	const SectionArray Sections;
+};
+
+// Process-wide cache of filter designs, so hundreds of instances with the same settings design them once.
+// Lookups never lock or wait and are safe on the audio thread. Inserts never wait either - a thread that
+// finds another one mid-insert just skips caching its design - but they may free memory, so they belong
+// off the audio thread. Memory is bounded: each key maps to a small set of slots and inserting into a
+// full set evicts its least recently used design.
+//
+// An evicted design can't be released straight away, since a lookup may have loaded it just before the
+// eviction. It goes on a retire list instead, and a later insert releases it once nothing can still be
+// reading it and no instance is still using it (so as long as users hold the design for as long as they
+// hold any of its sections, the memory is always freed by an inserting thread).
+class FilterDesignCache
+{
+public:
+	static FilterDesignCache& GetInstance();
+
+	~FilterDesignCache();
+
+	// Returns nullptr on a miss
+	FilterDesign::Ptr Find(const FilterDesignKey& Key);
+
+	// Returns the cached design for the new design's key, which may be an identical one another thread got in
+	// first. Not for the audio thread.
+	FilterDesign::Ptr Insert(FilterDesign::Ptr Design);
+
+	struct Statistics
+	{
+		juce::uint64 Hits = 0;
+		juce::uint64 Misses = 0;
+		juce::uint64 Insertions = 0;
+		juce::uint64 Evictions = 0;
+		int NumEntries = 0;
+		int NumRetired = 0; // Evicted but not released yet
+
+		double GetHitRate() const { return Hits + Misses > 0 ? static_cast<double>(Hits) / static_cast<double>(Hits + Misses) : 0.0; }
+	};
+
+	Statistics GetStatistics() const;
+
+	static constexpr int NumSets = 64;
+	static constexpr int NumWays = 4;
+	static constexpr int MaxRetired = 64;
+
+private:
+	FilterDesignCache() = default;
+
+	struct Slot
+	{
+		std::atomic<FilterDesign*> Design { nullptr }; // Holds one reference on behalf of the cache
+		std::atomic<int> NumReaders { 0 }; // An evicted design isn't released until this drops to zero
+		std::atomic<juce::uint32> LastUsed { 0 };
+	};
+
+	struct RetiredDesign
+	{
+		FilterDesign* Design = nullptr; // Still holds the cache's reference
+		const Slot* EvictedFrom = nullptr;
+	};
+
+	void ReleaseRetired();
+
+	std::array<Slot, NumSets * NumWays> Slots;
+	juce::SpinLock WriterLock;
+
+	// Only touched with the writer lock held
+	std::array<RetiredDesign, MaxRetired> Retired;
+	int NumRetired = 0;
+	std::atomic<juce::uint32> UseCounter { 0 };
+
+	std::atomic<juce::uint64> Hits { 0 };
+	std::atomic<juce::uint64> Misses { 0 };
+	std::atomic<juce::uint64> Insertions { 0 };
+	std::atomic<juce::uint64> Evictions { 0 };
+	std::atomic<int> NumEntries { 0 };
+	std::atomic<int> NumRetiredDesigns { 0 };
+
+	JUCE_DECLARE_NON_COPYABLE (FilterDesignCache)
+};
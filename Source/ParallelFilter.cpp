@@ -0,0 +1,291 @@
+#include "ParallelFilter.h"
+
+#include <complex>
+
+namespace
+{
+	using Complex = std::complex<double>;
+
+	// Repeated poles need higher order terms than the expansion has, and a pole at the origin has no 1/p.
+	// Poles that are merely close but distinct are fine as long as the coefficient and response checks pass.
+	constexpr double MinPoleSeparation = 1.0e-9;
+	constexpr double MinPoleMagnitude = 1.0e-9;
+
+	// Past this the sections are cancelling each other out so heavily that float rounding takes over
+	constexpr double MaxCoefficientMagnitude = 1.0e3;
+
+	// The parallel form's response has to stay within 1% of the cascade's, measured against a -60 dB floor.
+	// It's checked at DC and log-spaced from 1 Hz up to Nyquist, since the low cut's stopband is where the
+	// sections cancel each other out the most.
+	constexpr double ResponseTolerance = 1.0e-2;
+	constexpr double ResponseFloor = 1.0e-3;
+	constexpr double LowestCheckFrequency = 1.0;
+	constexpr int NumCheckFrequencies = 96;
+
+	// Evaluate a normalised biquad (b0, b1, b2, a1, a2) at q = z^-1
+	Complex EvaluateBiquad(const std::array<double, 5>& Section, Complex Q)
+	{
+		return (Section[0] + Q * (Section[1] + Q * Section[2])) / (1.0 + Q * (Section[3] + Q * Section[4]));
+	}
+}
+
+ParallelFilter::ParallelFilter()
+{
+	LanePositions.fill(-1);
+}
+
+void ParallelFilter::Update(const SectionCoefficients* const* Sections, const int* Positions, int NumSections, double SampleRate)
+{
+	jassert(NumSections <= MaxSections);
+
+	if (NumSections == NumCascadeSections && SampleRate == CascadeSampleRate && MatchesCascade(Sections, NumSections))
+		return;
+
+	NumCascadeSections = NumSections;
+	CascadeSampleRate = SampleRate;
+	for (int Section = 0; Section < NumSections; ++Section)
+	{
+		const auto NumCoefficients = juce::jmin(Sections[Section]->coefficients.size(), 5);
+		const auto* Raw = Sections[Section]->getRawCoefficients();
+		for (int i = 0; i < 5; ++i)
+			CascadeCoefficients[Section * 5 + i] = i < NumCoefficients ? Raw[i] : 0.f;
+	}
+
+	Usable = Design(Sections, Positions, NumSections, SampleRate);
+}
+
+bool ParallelFilter::MatchesCascade(const SectionCoefficients* const* Sections, int NumSections) const
+{
+	for (int Section = 0; Section < NumSections; ++Section)
+	{
+		if (Sections[Section]->coefficients.size() != 5)
+			return false;
+
+		const auto* Raw = Sections[Section]->getRawCoefficients();
+		for (int i = 0; i < 5; ++i)
+		{
+			if (Raw[i] != CascadeCoefficients[Section * 5 + i])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool ParallelFilter::Design(const SectionCoefficients* const* Sections, const int* Positions, int NumSections, double SampleRate)
+{
+	// 1. Pull out the cascade in double precision and find each section's pole pair (the roots of z^2 + a1 z + a2)
+	std::array<std::array<double, 5>, MaxSections> Cascade;
+	std::array<Complex, MaxSections * 2> Poles;
+	const int NumPoles = NumSections * 2;
+
+	for (int Section = 0; Section < NumSections; ++Section)
+	{
+		if (Sections[Section]->coefficients.size() != 5)
+			return false;
+
+		const auto* Raw = Sections[Section]->getRawCoefficients();
+		for (int i = 0; i < 5; ++i)
+			Cascade[Section][i] = Raw[i];
+
+		const auto A1 = Cascade[Section][3];
+		const auto A2 = Cascade[Section][4];
+		const auto Root = std::sqrt(Complex(A1 * A1 - 4.0 * A2, 0.0));
+		Poles[Section * 2] = (-A1 + Root) * 0.5;
+		Poles[Section * 2 + 1] = (-A1 - Root) * 0.5;
+	}
+
+	// 2. Partial-fraction expansion in q = z^-1. Every section denominator factors into (1 - p1 q)(1 - p2 q),
+	// so the residue of pole p is the cascade's numerator at q = 1/p over the product of the other pole factors.
+	auto EvaluateNumerator = [&](Complex Q)
+		{
+			Complex Numerator = 1.0;
+			for (int Section = 0; Section < NumSections; ++Section)
+				Numerator *= Cascade[Section][0] + Q * (Cascade[Section][1] + Q * Cascade[Section][2]);
+			return Numerator;
+		};
+
+	for (int i = 0; i < NumPoles; ++i)
+	{
+		const auto PoleMagnitude = std::abs(Poles[i]);
+		if (PoleMagnitude < MinPoleMagnitude || PoleMagnitude >= 1.0)
+			return false;
+
+		for (int j = i + 1; j < NumPoles; ++j)
+		{
+			if (std::abs(Poles[i] - Poles[j]) < MinPoleSeparation)
+				return false;
+		}
+	}
+
+	std::array<Complex, MaxSections * 2> Residues;
+	for (int i = 0; i < NumPoles; ++i)
+	{
+		const auto Q = 1.0 / Poles[i];
+		Complex Denominator = 1.0;
+		for (int j = 0; j < NumPoles; ++j)
+		{
+			if (j != i)
+				Denominator *= 1.0 - Poles[j] * Q;
+		}
+
+		Residues[i] = EvaluateNumerator(Q) / Denominator;
+	}
+
+	// At q = 0 every partial fraction reduces to its residue, so the direct term is whatever's left over
+	auto DirectTerm = EvaluateNumerator(0.0);
+	for (int i = 0; i < NumPoles; ++i)
+		DirectTerm -= Residues[i];
+
+	// 3. Recombine each pole pair into a real second-order section:
+	// r1 / (1 - p1 q) + r2 / (1 - p2 q) = ((r1 + r2) - (r1 p2 + r2 p1) q) / (1 + a1 q + a2 q^2)
+	std::array<float, MaxSections> NewB0 {};
+	std::array<float, MaxSections> NewB1 {};
+	std::array<float, MaxSections> NewA1 {};
+	std::array<float, MaxSections> NewA2 {};
+
+	for (int Section = 0; Section < NumSections; ++Section)
+	{
+		const auto& R1 = Residues[Section * 2];
+		const auto& R2 = Residues[Section * 2 + 1];
+		const auto& P1 = Poles[Section * 2];
+		const auto& P2 = Poles[Section * 2 + 1];
+
+		const auto SectionB0 = (R1 + R2).real();
+		const auto SectionB1 = -(R1 * P2 + R2 * P1).real();
+		if (std::abs(SectionB0) > MaxCoefficientMagnitude || std::abs(SectionB1) > MaxCoefficientMagnitude)
+			return false;
+
+		NewB0[Section] = static_cast<float>(SectionB0);
+		NewB1[Section] = static_cast<float>(SectionB1);
+		NewA1[Section] = static_cast<float>(Cascade[Section][3]);
+		NewA2[Section] = static_cast<float>(Cascade[Section][4]);
+	}
+
+	const auto NewDirectGain = static_cast<float>(DirectTerm.real());
+
+	// 4. Check the parallel form (with its coefficients rounded to float) against the cascade
+	const auto Nyquist = SampleRate * 0.5;
+	if (Nyquist <= LowestCheckFrequency)
+		return false;
+
+	const auto FrequencyRatio = Nyquist / LowestCheckFrequency;
+	for (int i = -1; i < NumCheckFrequencies; ++i)
+	{
+		const auto Frequency = i < 0 ? 0.0 : LowestCheckFrequency * std::pow(FrequencyRatio, static_cast<double>(i) / (NumCheckFrequencies - 1));
+		const auto Q = std::polar(1.0, -juce::MathConstants<double>::pi * Frequency / Nyquist);
+
+		Complex Serial = 1.0;
+		for (int Section = 0; Section < NumSections; ++Section)
+			Serial *= EvaluateBiquad(Cascade[Section], Q);
+
+		Complex Parallel = NewDirectGain;
+		for (int Section = 0; Section < NumSections; ++Section)
+		{
+			const std::array<double, 5> Rounded { NewB0[Section], NewB1[Section], 0.0, NewA1[Section], NewA2[Section] };
+			Parallel += EvaluateBiquad(Rounded, Q);
+		}
+
+		if (std::abs(Parallel - Serial) > ResponseTolerance * juce::jmax(std::abs(Serial), ResponseFloor))
+			return false;
+	}
+
+	// Sections are packed into the lanes in cascade order, so adding or removing one moves the others to
+	// different lanes. Their state follows them by cascade position, and new sections start from zero.
+	std::array<std::array<float, MaxSections>, MaxChannels> State1ByPosition {};
+	std::array<std::array<float, MaxSections>, MaxChannels> State2ByPosition {};
+	for (int Register = 0; Register < MaxRegisters; ++Register)
+	{
+		for (int Lane = 0; Lane < LanesPerRegister; ++Lane)
+		{
+			const auto Position = LanePositions[static_cast<size_t>(Register * LanesPerRegister + Lane)];
+			if (Position < 0)
+				continue;
+
+			for (int Channel = 0; Channel < MaxChannels; ++Channel)
+			{
+				State1ByPosition[Channel][static_cast<size_t>(Position)] = State1[Channel][Register].get(Lane);
+				State2ByPosition[Channel][static_cast<size_t>(Position)] = State2[Channel][Register].get(Lane);
+			}
+		}
+	}
+
+	// Lanes past the last section keep zero coefficients and state, so they contribute nothing to the sum
+	for (int Register = 0; Register < MaxRegisters; ++Register)
+	{
+		for (int Lane = 0; Lane < LanesPerRegister; ++Lane)
+		{
+			const auto Section = static_cast<size_t>(Register * LanesPerRegister + Lane);
+			const auto IsActive = Section < static_cast<size_t>(NumSections);
+			const auto Position = IsActive ? Positions[Section] : -1;
+			jassert(Position < MaxSections);
+
+			B0[Register].set(Lane, IsActive ? NewB0[Section] : 0.f);
+			B1[Register].set(Lane, IsActive ? NewB1[Section] : 0.f);
+			NegativeA1[Register].set(Lane, IsActive ? -NewA1[Section] : 0.f);
+			NegativeA2[Register].set(Lane, IsActive ? -NewA2[Section] : 0.f);
+			LanePositions[Section] = Position;
+
+			for (int Channel = 0; Channel < MaxChannels; ++Channel)
+			{
+				State1[Channel][Register].set(Lane, IsActive ? State1ByPosition[Channel][static_cast<size_t>(Position)] : 0.f);
+				State2[Channel][Register].set(Lane, IsActive ? State2ByPosition[Channel][static_cast<size_t>(Position)] : 0.f);
+			}
+		}
+	}
+
+	DirectGain = NewDirectGain;
+	NumActiveRegisters = (NumSections + LanesPerRegister - 1) / LanesPerRegister;
+
+	return true;
+}
+
+void ParallelFilter::Reset()
+{
+	for (int Channel = 0; Channel < MaxChannels; ++Channel)
+	{
+		State1[Channel].fill(SIMDFloat::expand(0.f));
+		State2[Channel].fill(SIMDFloat::expand(0.f));
+	}
+}
+
+void ParallelFilter::Process(juce::dsp::AudioBlock<float>& AudioBlock)
+{
+	const auto NumChannels = juce::jmin(AudioBlock.getNumChannels(), static_cast<size_t>(MaxChannels));
+	const auto NumSamples = AudioBlock.getNumSamples();
+	const auto NumRegisters = NumActiveRegisters;
+
+	// Work on local copies so nothing in the loop can alias the output samples and the coefficients
+	// and state can stay in registers for the whole block
+	const auto LocalB0 = B0;
+	const auto LocalB1 = B1;
+	const auto LocalNegativeA1 = NegativeA1;
+	const auto LocalNegativeA2 = NegativeA2;
+
+	for (size_t Channel = 0; Channel < NumChannels; ++Channel)
+	{
+		auto* Samples = AudioBlock.getChannelPointer(Channel);
+		auto S1 = State1[Channel];
+		auto S2 = State2[Channel];
+
+		for (size_t Sample = 0; Sample < NumSamples; ++Sample)
+		{
+			const auto Input = Samples[Sample];
+			const auto InputLanes = SIMDFloat::expand(Input);
+			auto Sum = SIMDFloat::expand(0.f);
+
+			for (int Register = 0; Register < NumRegisters; ++Register)
+			{
+				const auto Output = LocalB0[Register] * InputLanes + S1[Register];
+				S1[Register] = LocalB1[Register] * InputLanes + LocalNegativeA1[Register] * Output + S2[Register];
+				S2[Register] = LocalNegativeA2[Register] * Output;
+				Sum += Output;
+			}
+
+			Samples[Sample] = DirectGain * Input + Sum.sum();
+		}
+
+		State1[Channel] = S1;
+		State2[Channel] = S2;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Parallel realization of a cascade of biquads. The cascade's transfer function gets expanded into partial
+// fractions: one second-order section per original pole pair plus a direct gain term, all fed by the same
+// input and summed at the output. With no dependency between the sections they run side by side, one
+// section per lane of a SIMDRegister, rather than one after the other like the sections of a MonoChain.
+class ParallelFilter
+{
+public:
+	using SectionCoefficients = juce::dsp::IIR::Coefficients<float>;
+	using SIMDFloat = juce::dsp::SIMDRegister<float>;
+
+	static constexpr int MaxSections = 9; // 4 low-cut + peak + 4 high-cut
+	static constexpr int LanesPerRegister = static_cast<int>(SIMDFloat::SIMDNumElements);
+	static constexpr int MaxRegisters = (MaxSections + LanesPerRegister - 1) / LanesPerRegister;
+	static constexpr int MaxChannels = 2;
+
+	ParallelFilter();
+
+	// Redesign the parallel form if the cascade's coefficients have changed since the last call.
+	// The sections must all be second order. Each one comes with a fixed position in the full cascade
+	// (0 to MaxSections - 1), so a section keeps its state when others are added or removed around it.
+	void Update(const SectionCoefficients* const* Sections, const int* Positions, int NumSections, double SampleRate);
+
+	// False when the last conversion was ill-conditioned (so the serial cascade should be used instead)
+	bool IsUsable() const { return Usable; }
+
+	void Reset();
+	void Process(juce::dsp::AudioBlock<float>& AudioBlock);
+
+private:
+	bool Design(const SectionCoefficients* const* Sections, const int* Positions, int NumSections, double SampleRate);
+	bool MatchesCascade(const SectionCoefficients* const* Sections, int NumSections) const;
+
+	using RegisterArray = std::array<SIMDFloat, MaxRegisters>;
+
+	// Parallel sections, one per lane (b2 is always zero after the expansion, and the feedback
+	// coefficients are stored negated so the inner loop is all multiply-adds)
+	RegisterArray B0 {};
+	RegisterArray B1 {};
+	RegisterArray NegativeA1 {};
+	RegisterArray NegativeA2 {};
+	float DirectGain = 1.f;
+	int NumActiveRegisters = 0; // Only enough registers to hold the active sections get processed
+
+	// Transposed direct form II state for each channel
+	std::array<RegisterArray, MaxChannels> State1 {};
+	std::array<RegisterArray, MaxChannels> State2 {};
+
+	// Cascade position of the section in each lane (-1 for an unused lane)
+	std::array<int, MaxRegisters * LanesPerRegister> LanePositions;
+
+	// The cascade the current design was made from, so unchanged coefficients skip the redesign
+	std::array<float, MaxSections * 5> CascadeCoefficients {};
+	int NumCascadeSections = -1;
+	double CascadeSampleRate = 0.0;
+
+	bool Usable = false;
+};
@@ -46,8 +46,8 @@ void ResponseCurveComponent::timerCallback()
 		auto LowCutCoefficients = MakeLowCutFilter(ChainSettings, SampleRate);
 		auto HighCutCoefficients = MakeHighCutFilter(ChainSettings, SampleRate);
 
-		UpdateCutFilter(monoChain.get<ChainPositions::LowCut>(), LowCutCoefficients, ChainSettings.LowCutSlope);
-		UpdateCutFilter(monoChain.get<ChainPositions::HighCut>(), HighCutCoefficients, ChainSettings.HighCutSlope);
+		UpdateCutFilter(monoChain.get<ChainPositions::LowCut>(), LowCutCoefficients, ChainSettings.LowCutSlope, PassthroughCoefficients);
+		UpdateCutFilter(monoChain.get<ChainPositions::HighCut>(), HighCutCoefficients, ChainSettings.HighCutSlope, PassthroughCoefficients);
 
 		// Signal a repaint so a new response curve gets drawn
 		repaint();
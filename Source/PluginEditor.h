@@ -29,6 +29,7 @@ private:
     FODEQAudioProcessor& audioProcessor;
     juce::Atomic<bool> ParametersChanged = false;
     MonoChain monoChain;
+    Coefficients PassthroughCoefficients { new juce::dsp::IIR::Coefficients<float>(1.f, 0.f, 1.f, 0.f) };
 };
 
 // A basic example audio EQ plugin
@@ -9,6 +9,8 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+#include <cstring>
+
 static const juce::String LowCutParameterId = "LowCut Freq";
 static const juce::String LowCutParameterName = "LowCut Freq";
 static const juce::String HighCutParameterId = "HighCut Freq";
@@ -23,6 +25,18 @@ static const juce::String LowCutSlopeParameterId = "LowCut Slope";
 static const juce::String LowCutSlopeParameterName = "LowCut Slope";
 static const juce::String HighCutSlopeParameterId = "HighCut Slope";
 static const juce::String HighCutSlopeParameterName = "HighCut Slope";
+static const juce::String PeakDynamicParameterId = "Peak Dynamic";
+static const juce::String PeakDynamicParameterName = "Peak Dynamic";
+static const juce::String PeakThresholdParameterId = "Peak Threshold";
+static const juce::String PeakThresholdParameterName = "Peak Threshold";
+static const juce::String PeakRatioParameterId = "Peak Ratio";
+static const juce::String PeakRatioParameterName = "Peak Ratio";
+static const juce::String PeakAttackParameterId = "Peak Attack";
+static const juce::String PeakAttackParameterName = "Peak Attack";
+static const juce::String PeakReleaseParameterId = "Peak Release";
+static const juce::String PeakReleaseParameterName = "Peak Release";
+static const juce::String ParallelEngineParameterId = "Parallel Engine";
+static const juce::String ParallelEngineParameterName = "Parallel Engine";
 
 //==============================================================================
 FODEQAudioProcessor::FODEQAudioProcessor()
@@ -31,6 +45,7 @@ FODEQAudioProcessor::FODEQAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
@@ -121,8 +136,20 @@ void FODEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
     // Pass the spec to each chain to prepare for processing
     LeftChannelChain.prepare(ProcessSpec);
     RightChannelChain.prepare(ProcessSpec);
+    PeakBandDynamics.Prepare(sampleRate);
+    ChannelsLinked = false;
+
+    ParallelEngine.Reset();
+    ParallelEngineActive = false;
+    EngineFadeBuffer.setSize(ParallelFilter::MaxChannels, samplesPerBlock);
+    EngineFadeLength = juce::jmax(1, juce::roundToInt(sampleRate * 0.02)); // 20 ms
+    EngineFadeSamplesRemaining = 0;
 
-    UpdateFilters();
+    // The dynamic peak band rewrites its coefficients in place, so it gets its own full biquad rather than a shared design
+    auto ChainSettings = GetChainSettings(ValueTreeState);
+    DynamicPeakCoefficients = MakePeakFilter(ChainSettings, sampleRate);
+
+    UpdateFilters(ChainSettings, true);
 }
 
 void FODEQAudioProcessor::releaseResources()
@@ -150,6 +177,16 @@ bool FODEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) co
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+
+    // The sidechain is optional, but if it's enabled it has to be mono or stereo
+    if (layouts.inputBuses.size() > 1)
+    {
+        const auto SidechainChannelSet = layouts.getChannelSet(true, 1);
+        if (!SidechainChannelSet.isDisabled()
+         && SidechainChannelSet != juce::AudioChannelSet::mono()
+         && SidechainChannelSet != juce::AudioChannelSet::stereo())
+            return false;
+    }
    #endif
 
     return true;
@@ -172,24 +209,241 @@ void FODEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // Always update parameters *before* we process audio through them
-    UpdateFilters();
+    // Always update parameters *before* we process audio through them. Designs that aren't in the
+    // cache yet stay private to this instance rather than being shared from the audio thread.
+    auto ChainSettings = GetChainSettings(ValueTreeState);
+    UpdateFilters(ChainSettings, false);
 
     // Processor chain requires a processing context to get passed to it in order to run audio through the
     // links in the chain. To create a processing context we must supply it with an AudioBlock instance.
-    juce::dsp::AudioBlock<float> AudioBlock(buffer);
-    
+    // Only the main bus gets processed, the sidechain (if any) just feeds the peak band's detector.
+    auto MainBuffer = getBusBuffer(buffer, true, 0);
+    juce::dsp::AudioBlock<float> AudioBlock(MainBuffer);
+
+    auto* SidechainBus = getBusCount(true) > 1 ? getBus(true, 1) : nullptr;
+    const auto HasSidechain = SidechainBus != nullptr && SidechainBus->isEnabled() && SidechainBus->getNumberOfChannels() > 0;
+    auto SidechainBuffer = HasSidechain ? getBusBuffer(buffer, true, 1) : juce::AudioBuffer<float>();
+    juce::dsp::AudioBlock<float> SidechainBlock(SidechainBuffer);
+
+    ProcessEngines(AudioBlock, HasSidechain ? &SidechainBlock : nullptr, ChainSettings);
+}
+
+void FODEQAudioProcessor::SetParallelEngineEnabled(bool ShouldBeEnabled)
+{
+    if (auto* Parameter = ValueTreeState.getParameter(ParallelEngineParameterId))
+        Parameter->setValueNotifyingHost(ShouldBeEnabled ? 1.f : 0.f);
+}
+
+bool FODEQAudioProcessor::WantsParallelEngine(const ChainSettings& ChainSettings)
+{
+    // The dynamic peak band changes coefficients every few samples, far too often to keep converting to
+    // the parallel form, so it always runs through the serial chains
+    if (!ChainSettings.ParallelEngine || ChainSettings.PeakDynamic)
+        return false;
+
+    // Both chains share coefficients, so the left one describes the whole cascade. Only the links
+    // that aren't bypassed end up in the parallel form.
+    // Positions in the full cascade: low-cut links 0-3, the peak at 4, then high-cut links 5-8
+    constexpr int PeakPosition = 4;
+    std::array<const ParallelFilter::SectionCoefficients*, ParallelFilter::MaxSections> Sections;
+    std::array<int, ParallelFilter::MaxSections> Positions;
+    int NumSections = 0;
+    GatherActiveSections(LeftChannelChain.get<ChainPositions::LowCut>(), 0, Sections, Positions, NumSections);
+    if (!LeftChannelChain.isBypassed<ChainPositions::Peak>())
+    {
+        Sections[NumSections] = LeftChannelChain.get<ChainPositions::Peak>().coefficients.get();
+        Positions[NumSections++] = PeakPosition;
+    }
+    GatherActiveSections(LeftChannelChain.get<ChainPositions::HighCut>(), PeakPosition + 1, Sections, Positions, NumSections);
+
+    // Only redesigns when the coefficients have actually changed. A failed redesign leaves the previous
+    // parallel form in place, so it can still be faded out.
+    ParallelEngine.Update(Sections.data(), Positions.data(), NumSections, getSampleRate());
+    return ParallelEngine.IsUsable();
+}
+
+void FODEQAudioProcessor::ProcessEngines(juce::dsp::AudioBlock<float>& AudioBlock, const juce::dsp::AudioBlock<float>* SidechainBlock, const ChainSettings& ChainSettings)
+{
+    // A new switch only starts once the last crossfade has finished, so automation sweeping back and forth
+    // across the conditioning boundary can't flip engines any faster than one fade at a time
+    const auto UseParallel = WantsParallelEngine(ChainSettings);
+    if (UseParallel != ParallelEngineActive && EngineFadeSamplesRemaining == 0)
+    {
+        // The incoming engine's state is stale, so start it from silence while it's faded in
+        if (UseParallel)
+        {
+            ParallelEngine.Reset();
+        }
+        else
+        {
+            LeftChannelChain.reset();
+            RightChannelChain.reset();
+            ChannelsLinked = false;
+        }
+
+        ParallelEngineActive = UseParallel;
+        EngineFadeSamplesRemaining = EngineFadeLength;
+    }
+
+    if (EngineFadeSamplesRemaining == 0)
+    {
+        ProcessEngine(ParallelEngineActive, AudioBlock, SidechainBlock, ChainSettings);
+        return;
+    }
+
+    // Run both engines, in runs that fit the fade buffer, and crossfade linearly from the outgoing one to the incoming one
+    const auto NumSamples = AudioBlock.getNumSamples();
+    const auto MaxRunLength = static_cast<size_t>(EngineFadeBuffer.getNumSamples());
+    jassert(MaxRunLength > 0 && AudioBlock.getNumChannels() <= static_cast<size_t>(EngineFadeBuffer.getNumChannels()));
+
+    for (size_t StartSample = 0; StartSample < NumSamples; StartSample += MaxRunLength)
+    {
+        const auto RunLength = juce::jmin(NumSamples - StartSample, MaxRunLength);
+        auto OutgoingBlock = AudioBlock.getSubBlock(StartSample, RunLength);
+
+        juce::dsp::AudioBlock<float> RunSidechainBlock;
+        if (SidechainBlock != nullptr)
+            RunSidechainBlock = SidechainBlock->getSubBlock(StartSample, RunLength);
+        const auto* RunSidechain = SidechainBlock != nullptr ? &RunSidechainBlock : nullptr;
+
+        // Once the fade's done, whatever's left of the block only needs the incoming engine
+        if (EngineFadeSamplesRemaining == 0)
+        {
+            ProcessEngine(ParallelEngineActive, OutgoingBlock, RunSidechain, ChainSettings);
+            continue;
+        }
+
+        auto IncomingBlock = juce::dsp::AudioBlock<float>(EngineFadeBuffer)
+            .getSubsetChannelBlock(0, AudioBlock.getNumChannels())
+            .getSubBlock(0, RunLength);
+        IncomingBlock.copyFrom(OutgoingBlock);
+
+        ProcessEngine(!ParallelEngineActive, OutgoingBlock, RunSidechain, ChainSettings);
+        ProcessEngine(ParallelEngineActive, IncomingBlock, RunSidechain, ChainSettings);
+
+        for (size_t Channel = 0; Channel < AudioBlock.getNumChannels(); ++Channel)
+        {
+            auto* Outgoing = OutgoingBlock.getChannelPointer(Channel);
+            const auto* Incoming = IncomingBlock.getChannelPointer(Channel);
+            for (size_t Sample = 0; Sample < RunLength; ++Sample)
+            {
+                const auto SamplesLeft = juce::jmax(0, EngineFadeSamplesRemaining - static_cast<int>(Sample));
+                const auto IncomingGain = 1.f - static_cast<float>(SamplesLeft) / static_cast<float>(EngineFadeLength);
+                Outgoing[Sample] += IncomingGain * (Incoming[Sample] - Outgoing[Sample]);
+            }
+        }
+
+        EngineFadeSamplesRemaining = juce::jmax(0, EngineFadeSamplesRemaining - static_cast<int>(RunLength));
+    }
+}
+
+void FODEQAudioProcessor::ProcessEngine(bool UseParallel, juce::dsp::AudioBlock<float>& AudioBlock, const juce::dsp::AudioBlock<float>* SidechainBlock, const ChainSettings& ChainSettings)
+{
+    if (UseParallel)
+        ParallelEngine.Process(AudioBlock);
+    else if (!ChainSettings.PeakDynamic)
+        ProcessChains(AudioBlock);
+    else if (SidechainBlock != nullptr)
+        ProcessDynamicPeak(AudioBlock, *SidechainBlock);
+    else
+        ProcessDynamicPeak(AudioBlock, AudioBlock); // The detector reads each run of input samples before the chains overwrite them
+}
+
+// Chain states closer than this (-120 dB) count as matching, since filters fed the same input from
+// slightly different states converge but may never become bit-identical
+static constexpr float ChainStateTolerance = 1.0e-6f;
+
+static bool CutFilterStatesMatch(const CutFilter& First, const CutFilter& Second)
+{
+    return First.get<0>().StateMatches(Second.get<0>(), ChainStateTolerance)
+        && First.get<1>().StateMatches(Second.get<1>(), ChainStateTolerance)
+        && First.get<2>().StateMatches(Second.get<2>(), ChainStateTolerance)
+        && First.get<3>().StateMatches(Second.get<3>(), ChainStateTolerance);
+}
+
+static bool ChainStatesMatch(const MonoChain& First, const MonoChain& Second)
+{
+    return CutFilterStatesMatch(First.get<ChainPositions::LowCut>(), Second.get<ChainPositions::LowCut>())
+        && First.get<ChainPositions::Peak>().StateMatches(Second.get<ChainPositions::Peak>(), ChainStateTolerance)
+        && CutFilterStatesMatch(First.get<ChainPositions::HighCut>(), Second.get<ChainPositions::HighCut>());
+}
+
+static void CopyCutFilterState(CutFilter& Destination, const CutFilter& Source)
+{
+    Destination.get<0>().CopyStateFrom(Source.get<0>());
+    Destination.get<1>().CopyStateFrom(Source.get<1>());
+    Destination.get<2>().CopyStateFrom(Source.get<2>());
+    Destination.get<3>().CopyStateFrom(Source.get<3>());
+}
+
+static void CopyChainState(MonoChain& Destination, const MonoChain& Source)
+{
+    CopyCutFilterState(Destination.get<ChainPositions::LowCut>(), Source.get<ChainPositions::LowCut>());
+    Destination.get<ChainPositions::Peak>().CopyStateFrom(Source.get<ChainPositions::Peak>());
+    CopyCutFilterState(Destination.get<ChainPositions::HighCut>(), Source.get<ChainPositions::HighCut>());
+}
+
+void FODEQAudioProcessor::ProcessChains(juce::dsp::AudioBlock<float>& AudioBlock)
+{
     // Extract the left and right channel from the buffer (channels 0 and 1)
     auto LeftBlock = AudioBlock.getSingleChannelBlock(0);
-    auto RightBlock = AudioBlock.getSingleChannelBlock(1);
-
     juce::dsp::ProcessContextReplacing<float> LeftContext(LeftBlock);
+
+    if (AudioBlock.getNumChannels() < 2)
+    {
+        LeftChannelChain.process(LeftContext);
+        return;
+    }
+
+    auto RightBlock = AudioBlock.getSingleChannelBlock(1);
     juce::dsp::ProcessContextReplacing<float> RightContext(RightBlock);
 
+    // Dual-mono check: memcmp is a cheap (vectorised) bitwise comparison of the two inputs
+    const auto NumBytes = AudioBlock.getNumSamples() * sizeof(float);
+    const auto InputsIdentical = std::memcmp(LeftBlock.getChannelPointer(0), RightBlock.getChannelPointer(0), NumBytes) == 0;
+
+    if (InputsIdentical)
+    {
+        // Identical inputs only give identical outputs if both chains are in the same state as well
+        if (!ChannelsLinked)
+            ChannelsLinked = ChainStatesMatch(LeftChannelChain, RightChannelChain);
+
+        if (ChannelsLinked)
+        {
+            LeftChannelChain.process(LeftContext);
+            RightBlock.copyFrom(LeftBlock);
+            return;
+        }
+    }
+    else if (ChannelsLinked)
+    {
+        // The right chain sat idle while the channels were linked, so pick up from where the left one is
+        // to carry on without a discontinuity
+        CopyChainState(RightChannelChain, LeftChannelChain);
+        ChannelsLinked = false;
+    }
+
     LeftChannelChain.process(LeftContext);
     RightChannelChain.process(RightContext);
 }
 
+void FODEQAudioProcessor::ProcessDynamicPeak(juce::dsp::AudioBlock<float>& AudioBlock, const juce::dsp::AudioBlock<float>& DetectorBlock)
+{
+    // Work through the block in short runs, updating only the gain terms of the peak filter before each run
+    const auto NumSamples = AudioBlock.getNumSamples();
+    for (size_t StartSample = 0; StartSample < NumSamples; StartSample += PeakDynamics::UpdateInterval)
+    {
+        const auto RunLength = juce::jmin(NumSamples - StartSample, static_cast<size_t>(PeakDynamics::UpdateInterval));
+
+        // Both chains point at the same dynamic peak coefficients
+        const auto GainInDecibels = PeakBandDynamics.Process(DetectorBlock.getSubBlock(StartSample, RunLength));
+        SetPeakFilterGain(DynamicPeakCoefficients, PeakTerms, GainInDecibels);
+
+        auto RunBlock = AudioBlock.getSubBlock(StartSample, RunLength);
+        ProcessChains(RunBlock);
+    }
+}
+
 //==============================================================================
 bool FODEQAudioProcessor::hasEditor() const
 {
@@ -224,9 +478,13 @@ void FODEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes
     auto ValueTree = juce::ValueTree::readFromData(data, sizeInBytes);
     if (ValueTree.isValid())
     {
-        // Replace plugin state and update filters with saved parameter values
+        // Replace plugin state. Hosts can call this from any thread, so leave the filters alone here -
+        // processBlock picks the restored parameter values up at the start of the next block.
         ValueTreeState.replaceState(ValueTree);
-        UpdateFilters();
+
+        // This isn't the audio thread, so share the restored designs now for processBlock to find
+        if (getSampleRate() > 0.0)
+            ShareDesigns(GetChainSettings(ValueTreeState));
     }
 }
 
@@ -283,6 +541,38 @@ juce::AudioProcessorValueTreeState::ParameterLayout FODEQAudioProcessor::CreateP
     Layout.add(std::make_unique<juce::AudioParameterChoice>(LowCutSlopeParameterId, LowCutSlopeParameterName, OptionsArray, CutSlopeDefaultValue));
     Layout.add(std::make_unique<juce::AudioParameterChoice>(HighCutSlopeParameterId, HighCutSlopeParameterName, OptionsArray, CutSlopeDefaultValue));
 
+    // Dynamic mode for the peak band: an envelope follower pulls the peak gain down as the band's level
+    // goes over the threshold (e.g. for de-essing or taming resonances)
+    // a). Dynamic on/off
+    const bool PeakDynamicDefaultValue = false;
+    Layout.add(std::make_unique<juce::AudioParameterBool>(PeakDynamicParameterId, PeakDynamicParameterName, PeakDynamicDefaultValue));
+
+    // b). Threshold -> -60 dB - 0 dB
+    const float PeakThresholdDefaultValue = -20.f;
+    auto PeakThresholdNormalRange = juce::NormalisableRange<float>(-60.f, 0.f, 0.5f, 1.f);
+    Layout.add(std::make_unique<juce::AudioParameterFloat>(PeakThresholdParameterId, PeakThresholdParameterName, PeakThresholdNormalRange, PeakThresholdDefaultValue));
+
+    // c). Ratio -> 1:1 - 20:1
+    const float PeakRatioDefaultValue = 2.f;
+    auto PeakRatioNormalRange = juce::NormalisableRange<float>(1.f, 20.f, 0.1f, 0.5f);
+    Layout.add(std::make_unique<juce::AudioParameterFloat>(PeakRatioParameterId, PeakRatioParameterName, PeakRatioNormalRange, PeakRatioDefaultValue));
+
+    // d). Attack -> 0.1 ms - 200 ms
+    const float PeakAttackDefaultValue = 10.f;
+    auto PeakAttackNormalRange = juce::NormalisableRange<float>(0.1f, 200.f, 0.1f, 0.4f);
+    Layout.add(std::make_unique<juce::AudioParameterFloat>(PeakAttackParameterId, PeakAttackParameterName, PeakAttackNormalRange, PeakAttackDefaultValue));
+
+    // e). Release -> 1 ms - 2000 ms
+    const float PeakReleaseDefaultValue = 100.f;
+    auto PeakReleaseNormalRange = juce::NormalisableRange<float>(1.f, 2000.f, 1.f, 0.3f);
+    Layout.add(std::make_unique<juce::AudioParameterFloat>(PeakReleaseParameterId, PeakReleaseParameterName, PeakReleaseNormalRange, PeakReleaseDefaultValue));
+
+    // Processing option rather than a sound-shaping control: runs the EQ as a parallel sum of sections when
+    // that's accurate enough. It's saved with the session but can't be automated, since every switch costs a crossfade.
+    const bool ParallelEngineDefaultValue = false;
+    Layout.add(std::make_unique<juce::AudioParameterBool>(ParallelEngineParameterId, ParallelEngineParameterName, ParallelEngineDefaultValue,
+                                                          juce::AudioParameterBoolAttributes().withAutomatable(false)));
+
     return Layout;
 }
 
@@ -291,37 +581,254 @@ Coefficients MakePeakFilter(const ChainSettings& ChainSettings, double SampleRat
 	return juce::dsp::IIR::Coefficients<float>::makePeakFilter(SampleRate, ChainSettings.PeakFreq, ChainSettings.PeakQuality, juce::Decibels::decibelsToGain(ChainSettings.PeakGainInDecibels));
 }
 
-void FODEQAudioProcessor::UpdatePeakFilter(const ChainSettings& ChainSettings)
+PeakFilterTerms MakePeakFilterTerms(const ChainSettings& ChainSettings, double SampleRate)
+{
+    // Same design as juce::dsp::IIR::Coefficients::makePeakFilter, minus the gain
+    const auto Omega = juce::MathConstants<double>::twoPi * juce::jmax(static_cast<double>(ChainSettings.PeakFreq), 2.0) / SampleRate;
+
+    PeakFilterTerms Terms;
+    Terms.Alpha = static_cast<float>(std::sin(Omega) / (ChainSettings.PeakQuality * 2.0));
+    Terms.CosTerm = static_cast<float>(-2.0 * std::cos(Omega));
+    return Terms;
+}
+
+void SetPeakFilterGain(Coefficients& PeakCoefficients, const PeakFilterTerms& Terms, float GainInDecibels)
+{
+    jassert(PeakCoefficients->coefficients.size() == 5);
+
+    // A is the square root of the linear gain, i.e. 10^(dB / 40)
+    constexpr float DecibelsToExponent = 0.0575646273f; // ln(10) / 40
+    const auto A = std::exp(GainInDecibels * DecibelsToExponent);
+    const auto AlphaTimesA = Terms.Alpha * A;
+    const auto AlphaOverA = Terms.Alpha / A;
+    const auto InverseA0 = 1.f / (1.f + AlphaOverA);
+
+    // Normalised as b0, b1, b2, a1, a2
+    auto* Raw = PeakCoefficients->getRawCoefficients();
+    Raw[0] = (1.f + AlphaTimesA) * InverseA0;
+    Raw[1] = Terms.CosTerm * InverseA0;
+    Raw[2] = (1.f - AlphaTimesA) * InverseA0;
+    Raw[3] = Raw[1];
+    Raw[4] = (1.f - AlphaOverA) * InverseA0;
+}
+
+void SetBandPassFilter(Coefficients& BandPassCoefficients, const PeakFilterTerms& Terms)
+{
+    jassert(BandPassCoefficients->coefficients.size() == 5);
+
+    // Constant 0 dB peak gain band-pass sharing the peak filter's centre frequency and Q
+    const auto InverseA0 = 1.f / (1.f + Terms.Alpha);
+
+    auto* Raw = BandPassCoefficients->getRawCoefficients();
+    Raw[0] = Terms.Alpha * InverseA0;
+    Raw[1] = 0.f;
+    Raw[2] = -Terms.Alpha * InverseA0;
+    Raw[3] = Terms.CosTerm * InverseA0;
+    Raw[4] = (1.f - Terms.Alpha) * InverseA0;
+}
+
+void PeakDynamics::Prepare(double NewSampleRate)
+{
+    SampleRate = NewSampleRate;
+
+    juce::dsp::ProcessSpec ProcessSpec;
+    ProcessSpec.maximumBlockSize = UpdateInterval;
+    ProcessSpec.numChannels = 1;
+    ProcessSpec.sampleRate = SampleRate;
+
+    // Give each detector a full biquad up front so Update can rewrite it in place
+    for (auto& DetectorFilter : DetectorFilters)
+    {
+        DetectorFilter.coefficients = juce::dsp::IIR::Coefficients<float>::makeBandPass(SampleRate, 1000.0);
+        DetectorFilter.prepare(ProcessSpec);
+    }
+
+    Reset();
+}
+
+void PeakDynamics::Reset()
+{
+    for (auto& DetectorFilter : DetectorFilters)
+        DetectorFilter.reset();
+
+    Envelope = 0.f;
+    GainInDecibels = 0.f;
+}
+
+void PeakDynamics::Update(const ChainSettings& ChainSettings, const PeakFilterTerms& Terms)
+{
+    for (auto& DetectorFilter : DetectorFilters)
+        SetBandPassFilter(DetectorFilter.coefficients, Terms);
+
+    // One-pole smoothing coefficients for the envelope
+    AttackCoefficient = static_cast<float>(std::exp(-1000.0 / (ChainSettings.PeakAttackInMilliseconds * SampleRate)));
+    ReleaseCoefficient = static_cast<float>(std::exp(-1000.0 / (ChainSettings.PeakReleaseInMilliseconds * SampleRate)));
+
+    GainInDecibels = ChainSettings.PeakGainInDecibels;
+    ThresholdInDecibels = ChainSettings.PeakThresholdInDecibels;
+    ReductionPerDecibel = 1.f - 1.f / ChainSettings.PeakRatio;
+}
+
+float PeakDynamics::Process(const juce::dsp::AudioBlock<float>& DetectorBlock)
+{
+    // Stereo-linked detection: the loudest channel drives the envelope so both channels get the same gain
+    const auto NumChannels = juce::jmin(DetectorBlock.getNumChannels(), static_cast<size_t>(MaxDetectorChannels));
+    const auto NumSamples = DetectorBlock.getNumSamples();
+
+    for (size_t Sample = 0; Sample < NumSamples; ++Sample)
+    {
+        float Level = 0.f;
+        for (size_t Channel = 0; Channel < NumChannels; ++Channel)
+            Level = juce::jmax(Level, std::abs(DetectorFilters[Channel].processSample(DetectorBlock.getSample(static_cast<int>(Channel), static_cast<int>(Sample)))));
+
+        const auto Coefficient = Level > Envelope ? AttackCoefficient : ReleaseCoefficient;
+        Envelope = Level + Coefficient * (Envelope - Level);
+    }
+
+    // Pull the band's gain down by however far the envelope sits over the threshold, scaled by the ratio
+    const auto Overshoot = juce::jmax(0.f, juce::Decibels::gainToDecibels(Envelope) - ThresholdInDecibels);
+    return juce::jlimit(-24.f, 24.f, GainInDecibels - Overshoot * ReductionPerDecibel);
+}
+
+// Quantize the settings a band's design depends on, so near-identical settings share one design
+static FilterDesignKey MakeDesignKey(FilterDesignKey::BandType Band, const ChainSettings& ChainSettings, double SampleRate)
+{
+    FilterDesignKey Key;
+    Key.Band = Band;
+    Key.SampleRate = juce::roundToInt(SampleRate);
+
+    switch (Band)
+    {
+    case FilterDesignKey::BandType::LowCut:
+        Key.Frequency = juce::roundToInt(ChainSettings.LowCutFreq * 100.f);
+        Key.Slope = ChainSettings.LowCutSlope;
+        break;
+    case FilterDesignKey::BandType::Peak:
+        Key.Frequency = juce::roundToInt(ChainSettings.PeakFreq * 100.f);
+        Key.Gain = juce::roundToInt(ChainSettings.PeakGainInDecibels * 100.f);
+        Key.Quality = juce::roundToInt(ChainSettings.PeakQuality * 1000.f);
+        break;
+    case FilterDesignKey::BandType::HighCut:
+        Key.Frequency = juce::roundToInt(ChainSettings.HighCutFreq * 100.f);
+        Key.Slope = ChainSettings.HighCutSlope;
+        break;
+    }
+
+    return Key;
+}
+
+// Fetch a design from the process-wide cache, designing it on a miss. The new design only gets shared when
+// the caller isn't the audio thread: inserting may free evicted designs, and on the audio thread every
+// step of an automation sweep would be a one-off key pushing other instances' designs out of the cache.
+static FilterDesign::Ptr GetSharedDesign(const FilterDesignKey& Key, bool ShareNewDesign)
+{
+    auto& Cache = FilterDesignCache::GetInstance();
+    auto Design = Cache.Find(Key);
+    if (Design != nullptr)
+        return Design;
+
+    // Design from the quantized values so every instance with this key ends up with exactly the same coefficients
+    ChainSettings QuantizedSettings;
+    const auto Frequency = Key.Frequency / 100.f;
+    FilterDesign::SectionArray Sections;
+
+    switch (Key.Band)
+    {
+    case FilterDesignKey::BandType::LowCut:
+        QuantizedSettings.LowCutFreq = Frequency;
+        QuantizedSettings.LowCutSlope = static_cast<Slope>(Key.Slope);
+        Sections = MakeLowCutFilter(QuantizedSettings, Key.SampleRate);
+        break;
+    case FilterDesignKey::BandType::Peak:
+        QuantizedSettings.PeakFreq = Frequency;
+        QuantizedSettings.PeakGainInDecibels = Key.Gain / 100.f;
+        QuantizedSettings.PeakQuality = Key.Quality / 1000.f;
+        Sections.add(MakePeakFilter(QuantizedSettings, Key.SampleRate));
+        break;
+    case FilterDesignKey::BandType::HighCut:
+        QuantizedSettings.HighCutFreq = Frequency;
+        QuantizedSettings.HighCutSlope = static_cast<Slope>(Key.Slope);
+        Sections = MakeHighCutFilter(QuantizedSettings, Key.SampleRate);
+        break;
+    }
+
+    FilterDesign::Ptr NewDesign = new FilterDesign(Key, std::move(Sections));
+    return ShareNewDesign ? Cache.Insert(NewDesign) : NewDesign;
+}
+
+void FODEQAudioProcessor::ShareDesigns(const ChainSettings& ChainSettings)
 {
-    auto PeakCoefficients = MakePeakFilter(ChainSettings, getSampleRate());
-    SetCoefficients(LeftChannelChain.get<ChainPositions::Peak>().coefficients, PeakCoefficients);
-    SetCoefficients(RightChannelChain.get<ChainPositions::Peak>().coefficients, PeakCoefficients);
+    // Only touches the shared cache, never this instance's filters
+    const auto SampleRate = getSampleRate();
+    GetSharedDesign(MakeDesignKey(FilterDesignKey::BandType::LowCut, ChainSettings, SampleRate), true);
+    if (!ChainSettings.PeakDynamic)
+        GetSharedDesign(MakeDesignKey(FilterDesignKey::BandType::Peak, ChainSettings, SampleRate), true);
+    GetSharedDesign(MakeDesignKey(FilterDesignKey::BandType::HighCut, ChainSettings, SampleRate), true);
 }
 
-void FODEQAudioProcessor::UpdateLowCutFilters(const ChainSettings& ChainSettings)
+void FODEQAudioProcessor::UpdatePeakFilter(const ChainSettings& ChainSettings, bool ShareNewDesigns)
 {
-    auto LowCutCoefficients = MakeLowCutFilter(ChainSettings, getSampleRate());
+    // The detector sits idle while dynamic mode is off, so it starts afresh each time the mode comes back
+    // on rather than acting on an envelope left over from whenever it was last switched off
+    const auto DynamicModeStarting = ChainSettings.PeakDynamic && !PeakDynamicActive;
+    PeakDynamicActive = ChainSettings.PeakDynamic;
+    if (DynamicModeStarting)
+        PeakBandDynamics.Reset();
+
+    // In dynamic mode the peak coefficients get rewritten from the cached terms while processing
+    if (ChainSettings.PeakDynamic)
+    {
+        PeakTerms = MakePeakFilterTerms(ChainSettings, getSampleRate());
+        PeakBandDynamics.Update(ChainSettings, PeakTerms);
+        LeftChannelChain.get<ChainPositions::Peak>().coefficients = DynamicPeakCoefficients;
+        RightChannelChain.get<ChainPositions::Peak>().coefficients = DynamicPeakCoefficients;
+        return;
+    }
+
+    // The links move onto the new design before the old one is let go, so the inserting thread that releases
+    // an evicted design is never left sharing its coefficients with these chains
+    const auto Key = MakeDesignKey(FilterDesignKey::BandType::Peak, ChainSettings, getSampleRate());
+    auto Design = PeakDesign != nullptr && PeakDesign->Key == Key ? PeakDesign : GetSharedDesign(Key, ShareNewDesigns);
+
+    LeftChannelChain.get<ChainPositions::Peak>().coefficients = Design->Sections[0];
+    RightChannelChain.get<ChainPositions::Peak>().coefficients = Design->Sections[0];
+    PeakDesign = Design;
+}
+
+void FODEQAudioProcessor::UpdateLowCutFilters(const ChainSettings& ChainSettings, bool ShareNewDesigns)
+{
+    // Nothing to do unless the settings have moved on to a different design
+    const auto Key = MakeDesignKey(FilterDesignKey::BandType::LowCut, ChainSettings, getSampleRate());
+    if (LowCutDesign != nullptr && LowCutDesign->Key == Key)
+        return;
+
+    auto Design = GetSharedDesign(Key, ShareNewDesigns);
 	auto& LeftLowCut = LeftChannelChain.get<ChainPositions::LowCut>();
 	auto& RightLowCut = RightChannelChain.get<ChainPositions::LowCut>();
-	UpdateCutFilter(LeftLowCut, LowCutCoefficients, ChainSettings.LowCutSlope);
-	UpdateCutFilter(RightLowCut, LowCutCoefficients, ChainSettings.LowCutSlope);
+	UpdateCutFilter(LeftLowCut, Design->Sections, ChainSettings.LowCutSlope, PassthroughCoefficients);
+	UpdateCutFilter(RightLowCut, Design->Sections, ChainSettings.LowCutSlope, PassthroughCoefficients);
+    LowCutDesign = Design; // Only let go of the old design once no link uses it
 }
 
-void FODEQAudioProcessor::UpdateHighCutFilters(const ChainSettings& ChainSettings)
+void FODEQAudioProcessor::UpdateHighCutFilters(const ChainSettings& ChainSettings, bool ShareNewDesigns)
 {
-    auto& HighCutCoefficients = MakeHighCutFilter(ChainSettings, getSampleRate());
+    const auto Key = MakeDesignKey(FilterDesignKey::BandType::HighCut, ChainSettings, getSampleRate());
+    if (HighCutDesign != nullptr && HighCutDesign->Key == Key)
+        return;
+
+    auto Design = GetSharedDesign(Key, ShareNewDesigns);
 	auto& LeftHighCut = LeftChannelChain.get<ChainPositions::HighCut>();
 	auto& RightHighCut = RightChannelChain.get<ChainPositions::HighCut>();
-	UpdateCutFilter(LeftHighCut, HighCutCoefficients, ChainSettings.HighCutSlope);
-	UpdateCutFilter(RightHighCut, HighCutCoefficients, ChainSettings.HighCutSlope);
+	UpdateCutFilter(LeftHighCut, Design->Sections, ChainSettings.HighCutSlope, PassthroughCoefficients);
+	UpdateCutFilter(RightHighCut, Design->Sections, ChainSettings.HighCutSlope, PassthroughCoefficients);
+    HighCutDesign = Design;
 }
 
-void FODEQAudioProcessor::UpdateFilters()
+void FODEQAudioProcessor::UpdateFilters(const ChainSettings& ChainSettings, bool ShareNewDesigns)
 {
-    auto ChainSettings = GetChainSettings(ValueTreeState);
-    UpdateLowCutFilters(ChainSettings);
-    UpdatePeakFilter(ChainSettings);
-    UpdateHighCutFilters(ChainSettings);
+    UpdateLowCutFilters(ChainSettings, ShareNewDesigns);
+    UpdatePeakFilter(ChainSettings, ShareNewDesigns);
+    UpdateHighCutFilters(ChainSettings, ShareNewDesigns);
 }
 
 //==============================================================================
@@ -342,6 +849,12 @@ ChainSettings GetChainSettings(juce::AudioProcessorValueTreeState& ValueTreeStat
     Settings.PeakQuality = ValueTreeState.getRawParameterValue(PeakQualityParameterName)->load();
     Settings.LowCutSlope = static_cast<Slope>(ValueTreeState.getRawParameterValue(LowCutSlopeParameterName)->load());
     Settings.HighCutSlope = static_cast<Slope>(ValueTreeState.getRawParameterValue(HighCutSlopeParameterName)->load());
+    Settings.PeakDynamic = ValueTreeState.getRawParameterValue(PeakDynamicParameterName)->load() > 0.5f;
+    Settings.PeakThresholdInDecibels = ValueTreeState.getRawParameterValue(PeakThresholdParameterName)->load();
+    Settings.PeakRatio = ValueTreeState.getRawParameterValue(PeakRatioParameterName)->load();
+    Settings.PeakAttackInMilliseconds = ValueTreeState.getRawParameterValue(PeakAttackParameterName)->load();
+    Settings.PeakReleaseInMilliseconds = ValueTreeState.getRawParameterValue(PeakReleaseParameterName)->load();
+    Settings.ParallelEngine = ValueTreeState.getRawParameterValue(ParallelEngineParameterName)->load() > 0.5f;
 
     return Settings;
 }
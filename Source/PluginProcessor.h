@@ -1,9 +1,12 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ParallelFilter.h"
+#include "FilterDesignCache.h"
+#include "BiquadFilter.h"
 
 // Type aliases (since the DSP namespace uses a lot of nested namespaces)
-using Filter = juce::dsp::IIR::Filter<float>;
+using Filter = BiquadFilter;
 using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
 using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
 
@@ -31,6 +34,12 @@ struct ChainSettings
 	float HighCutFreq = 0.f;
 	Slope LowCutSlope = Slope::Slope_12;
 	Slope HighCutSlope = Slope::Slope_12;
+	bool PeakDynamic = false;
+	float PeakThresholdInDecibels = 0.f;
+	float PeakRatio = 1.f;
+	float PeakAttackInMilliseconds = 10.f;
+	float PeakReleaseInMilliseconds = 100.f;
+	bool ParallelEngine = false;
 };
 
 ChainSettings GetChainSettings(juce::AudioProcessorValueTreeState& ValueTreeState);
@@ -40,21 +49,44 @@ void SetCoefficients(Coefficients& Old, const Coefficients& Replacements);
 
 Coefficients MakePeakFilter(const ChainSettings& ChainSettings, double SampleRate);
 
+// The parts of the peak filter design that don't depend on the gain. With these cached, a change of
+// peak gain only costs a handful of multiplies instead of a full call to MakePeakFilter.
+struct PeakFilterTerms
+{
+	float Alpha = 0.f; // sin(omega) / 2Q
+	float CosTerm = 0.f; // -2cos(omega)
+};
+
+PeakFilterTerms MakePeakFilterTerms(const ChainSettings& ChainSettings, double SampleRate);
+
+// Both of these write in place, so the coefficients must already hold a second-order design
+void SetPeakFilterGain(Coefficients& PeakCoefficients, const PeakFilterTerms& Terms, float GainInDecibels);
+void SetBandPassFilter(Coefficients& BandPassCoefficients, const PeakFilterTerms& Terms);
+
 template<int Index, typename ChainType, typename CoefficientType>
 void UpdateCoefficient(ChainType& Chain, const CoefficientType& Coefficients)
 {
-	SetCoefficients(Chain.get<Index>().coefficients, Coefficients[Index]);
+	// Share the coefficients rather than copying them (the designs they come from never get modified)
+	Chain.get<Index>().coefficients = Coefficients[Index];
 	Chain.setBypassed<Index>(false);
 }
 
+template<int Index, typename ChainType>
+void BypassLink(ChainType& Chain, const Coefficients& Passthrough)
+{
+	// Drop the link's reference to whatever design it was using, so a bypassed link never keeps an old design's coefficients alive
+	Chain.template get<Index>().coefficients = Passthrough;
+	Chain.template setBypassed<Index>(true);
+}
+
 template<typename ChainType, typename CoefficientType>
-void UpdateCutFilter(ChainType& Chain, const CoefficientType& Coefficients, const Slope& Slope)
+void UpdateCutFilter(ChainType& Chain, const CoefficientType& Coefficients, const Slope& Slope, const ::Coefficients& Passthrough)
 {
 	// Bypass all links in the chain, then assign coefficients to chain links based on the order number
-	Chain.setBypassed<0>(true);
-	Chain.setBypassed<1>(true);
-	Chain.setBypassed<2>(true);
-	Chain.setBypassed<3>(true);
+	BypassLink<0>(Chain, Passthrough);
+	BypassLink<1>(Chain, Passthrough);
+	BypassLink<2>(Chain, Passthrough);
+	BypassLink<3>(Chain, Passthrough);
 
 	switch (Slope)
 	{
@@ -78,6 +110,27 @@ void UpdateCutFilter(ChainType& Chain, const CoefficientType& Coefficients, cons
 	}
 }
 
+template<int Index, typename CutChainType, typename SectionArrayType, typename PositionArrayType>
+void GatherSection(const CutChainType& Chain, int FirstPosition, SectionArrayType& Sections, PositionArrayType& Positions, int& NumSections)
+{
+	if (Chain.template isBypassed<Index>())
+		return;
+
+	Sections[NumSections] = Chain.template get<Index>().coefficients.get();
+	Positions[NumSections++] = FirstPosition + Index;
+}
+
+// Collect the links of a cut filter that aren't bypassed, with each one's position in the full cascade
+// counting up from FirstPosition
+template<typename CutChainType, typename SectionArrayType, typename PositionArrayType>
+void GatherActiveSections(const CutChainType& Chain, int FirstPosition, SectionArrayType& Sections, PositionArrayType& Positions, int& NumSections)
+{
+	GatherSection<0>(Chain, FirstPosition, Sections, Positions, NumSections);
+	GatherSection<1>(Chain, FirstPosition, Sections, Positions, NumSections);
+	GatherSection<2>(Chain, FirstPosition, Sections, Positions, NumSections);
+	GatherSection<3>(Chain, FirstPosition, Sections, Positions, NumSections);
+}
+
 inline auto MakeLowCutFilter(const ChainSettings& ChainSettings, double SampleRate)
 {
 	return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(ChainSettings.LowCutFreq, SampleRate, 2 * (ChainSettings.LowCutSlope + 1));
@@ -87,6 +140,34 @@ inline auto MakeHighCutFilter(const ChainSettings& ChainSettings, double SampleR
 {
 	return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(ChainSettings.HighCutFreq, SampleRate, 2 * (ChainSettings.HighCutSlope + 1));
 }
+// Envelope follower and gain computer that drive the peak band's gain when it's in dynamic mode.
+// The detector listens to the band-passed main input, or to the sidechain when one is connected.
+class PeakDynamics
+{
+public:
+	static constexpr int UpdateInterval = 16; // Samples between peak gain updates
+	static constexpr int MaxDetectorChannels = 2;
+
+	void Prepare(double SampleRate);
+	void Reset();
+
+	// Refresh the detector band and the envelope timings, called once per block
+	void Update(const ChainSettings& ChainSettings, const PeakFilterTerms& Terms);
+
+	// Run the detector over a short block of samples and return the peak gain to apply to them
+	float Process(const juce::dsp::AudioBlock<float>& DetectorBlock);
+
+private:
+	std::array<Filter, MaxDetectorChannels> DetectorFilters;
+	double SampleRate = 44100.0;
+	float Envelope = 0.f;
+	float AttackCoefficient = 0.f;
+	float ReleaseCoefficient = 0.f;
+	float GainInDecibels = 0.f;
+	float ThresholdInDecibels = 0.f;
+	float ReductionPerDecibel = 0.f; // Gain reduction per decibel over the threshold (1 - 1/ratio)
+};
+
 //==============================================================================
 /**
 * A basic EQ 
@@ -135,15 +216,53 @@ public:
 	static juce::AudioProcessorValueTreeState::ParameterLayout CreateParameterLayout();
 	juce::AudioProcessorValueTreeState ValueTreeState {*this, nullptr, "Parameters", CreateParameterLayout()};
 
+	// Run the EQ as a parallel sum of sections instead of the serial cascade when the conversion is well-conditioned.
+	// Same as setting the (non-automatable) "Parallel Engine" parameter, which is saved with the plugin state.
+	void SetParallelEngineEnabled(bool ShouldBeEnabled);
+
 private:
 	MonoChain LeftChannelChain;
 	MonoChain RightChannelChain;
 
-	void UpdatePeakFilter(const ChainSettings& ChainSettings);
-	void UpdateLowCutFilters(const ChainSettings& ChainSettings);
-	void UpdateHighCutFilters(const ChainSettings& ChainSettings);
+	PeakDynamics PeakBandDynamics;
+	bool PeakDynamicActive = false; // Whether the last filter update was in dynamic mode
+	PeakFilterTerms PeakTerms;
+	Coefficients DynamicPeakCoefficients; // Owned by this instance, since dynamic mode rewrites it in place
+
+	// Designs currently in use, shared with any other instances using the same settings. The chains only ever
+	// hold coefficients from these (or instance-owned ones), so these references keep every shared section alive.
+	FilterDesign::Ptr LowCutDesign;
+	FilterDesign::Ptr PeakDesign;
+	FilterDesign::Ptr HighCutDesign;
+	Coefficients PassthroughCoefficients { new juce::dsp::IIR::Coefficients<float>(1.f, 0.f, 1.f, 0.f) }; // For bypassed cut links
+
+	ParallelFilter ParallelEngine;
+	bool ParallelEngineActive = false;
+
+	// Switching between the parallel and serial engines crossfades from one to the other. The incoming
+	// engine runs on a copy of the input in here while the outgoing one carries on with the real buffer.
+	juce::AudioBuffer<float> EngineFadeBuffer;
+	int EngineFadeLength = 0;
+	int EngineFadeSamplesRemaining = 0;
+
+	// True while the inputs are dual-mono and only the left chain is running (the right chain's state is stale)
+	bool ChannelsLinked = false;
+
+	void UpdatePeakFilter(const ChainSettings& ChainSettings, bool ShareNewDesigns);
+	void UpdateLowCutFilters(const ChainSettings& ChainSettings, bool ShareNewDesigns);
+	void UpdateHighCutFilters(const ChainSettings& ChainSettings, bool ShareNewDesigns);
+
+	// Designs missing from the shared cache are only added to it when ShareNewDesigns is set, which the audio thread never does
+	void UpdateFilters(const ChainSettings& ChainSettings, bool ShareNewDesigns);
+
+	// Put the designs for these settings in the shared cache ahead of time, so the audio thread finds them there
+	void ShareDesigns(const ChainSettings& ChainSettings);
 
-	void UpdateFilters();
+	bool WantsParallelEngine(const ChainSettings& ChainSettings);
+	void ProcessEngines(juce::dsp::AudioBlock<float>& AudioBlock, const juce::dsp::AudioBlock<float>* SidechainBlock, const ChainSettings& ChainSettings);
+	void ProcessEngine(bool UseParallel, juce::dsp::AudioBlock<float>& AudioBlock, const juce::dsp::AudioBlock<float>* SidechainBlock, const ChainSettings& ChainSettings);
+	void ProcessChains(juce::dsp::AudioBlock<float>& AudioBlock);
+	void ProcessDynamicPeak(juce::dsp::AudioBlock<float>& AudioBlock, const juce::dsp::AudioBlock<float>& DetectorBlock);
 
 	//==============================================================================
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FODEQAudioProcessor)